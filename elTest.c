@@ -9,6 +9,12 @@
 
 #include "planarTouch.h"
 
+// The one display on this board, wired as in planarTouch.h
+elpanel display = EL_PANEL(EL_DATA, PIN_DATA, DDR_DATA, EL_CTRL, DDR_CTRL);
+elpanel *panels[] = { &display };
+
+volatile uint8_t touched;	// Set by the INT0 handler, cleared once handled
+
 // Init touchscreen
 void touchInit(void) {
 
@@ -20,33 +26,49 @@ int main(void) {
 
 	cli();
 	
+	elInitFast(&display, NULL, NULL);
+	
 	touchInit();
 	
-	_delay_ms(500);
+	while (elBootStep(&display));	// clear the screen, boot work that leaves the panel alone can go in here too
 	
-	elInit();
+	stdout = &display.stream;
 	
 	sei();
 	
 	for (uint8_t x=0; x<80; x++) {
-		elPixel(x, x, on);
-		elPixel(x, x+80, on);
-		elPixel(79-x, x, on);
-		elPixel(79-x, x+80, on);
+		elPixel(&display, x, x, on);
+		elPixel(&display, x, x+80, on);
+		elPixel(&display, 79-x, x, on);
+		elPixel(&display, 79-x, x+80, on);
 	}
 
 	//EL_CursorXY(0,1);
 	//printf("EL160.80.38-SM1");
 	
-	for (;;);
+	// Panel and MCU power down after EL_IDLE_TICKS * 10ms without a touch
+	for (;;) {
+		_delay_ms(10);
+		elPowerTick(panels, 1);		// wakes the panel after a touch
+		
+		if (touched) {
+			uint16_t touchCoord = elTouchscreenRead(&display);
+			
+			elCursorXY(&display, 0,3);
+			printf("Touch at row:%d, col:%d", (char)(touchCoord >> 8), (char) touchCoord);
+			
+			touched = 0;
+			EIMSK |= (1 << INT0);	// Listen for the next touch
+		}
+	}
 }
 
-// INT0 interrupt vector. Any touchscreen handling is done here.
+// INT0 interrupt vector. Only flags the touch: the main loop may
+// be in the middle of a bus transaction, and the panel may still
+// be in standby.
 ISR(INT0_vect) {
 
-	uint16_t volatile touchCoord = elTouchscreenRead();
-	
-	elCursorXY(0,3);
-	printf("Touch at row:%d, col:%d", (char)(touchCoord >> 8), (char) touchCoord);
-	
+	elPowerActivity();
+	touched = 1;
+	EIMSK &= ~(1 << INT0);		// Level triggered, keep quiet until handled
 }
@@ -59,24 +59,55 @@
 //
 // *************************************************************
 
+
 #include <stdio.h>
 #include <math.h>
 #include <avr/io.h>
+#include <avr/sleep.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include "planarTouch.h"
 #include <util/delay.h>
 #include <string.h>
 
 // *******************************************************
 // Function Prototypes 
-void elSendByte (unsigned  char value );				// Send Data Byte
-void elSendCommand (unsigned  char value );				// Send Command Byte
-unsigned char elRead (int command);			// Get Data or cursor information
+void elSendByte (elpanel *p, unsigned  char value );		// Send Data Byte
+void elSendCommand (elpanel *p, unsigned  char value );		// Send Command Byte
+unsigned char elRead (elpanel *p, int command);			// Get Data or cursor information
+void elSetScroll(elpanel *p, uint16_t textAddr, uint16_t graphAddr, uint16_t textLow, uint16_t graphLow);	// Set start addresses of the visible screen
+uint16_t elPageBase(int8_t page);				// Offset of page's address map
+void elSysSet(elpanel *p);					// Send system set up
+void elSetup(elpanel *p);					// Configure controller after reset
+void elBusInit(elpanel *p);					// Set bus pin directions and idle levels
+void elResetAll(elpanel **panels, uint8_t n, uint8_t fast);	// One /RES pulse for all panels
+void elSetCursor(elpanel *p, uint16_t addr);	// Set VRAM address of next read or write
+void elFillAll(elpanel **panels, uint8_t n, uint8_t graph, uint8_t value);	// Interleaved layer fill
+static int elPrintChar(char myChar, FILE *stream);	/* for using STDIO in avr-libc */
 
 //*******************************************************
 // defines
 //*******************************************************
 
-static FILE myStdOut = FDEV_SETUP_STREAM(elPrintChar, NULL,_FDEV_SETUP_WRITE);
+// Lines in each half of the screen (SL1/SL2), and the layer
+// sizes the driver draws and clears
+#define LINES(p)		((p)->charRows * EL_CHARHEIGHT)
+#define GRAPHSIZE(p)	((p)->addrIncr * LINES(p))
+#define TEXTSIZE(p)		((p)->addrIncr * (p)->charRows)
+
+// /CS only has to be driven when the panel shares the bus
+#define SELECT(p)		do { if ((p)->cs) *(p)->cs &= ~(p)->csMask; } while (0)
+#define DESELECT(p)		do { if ((p)->cs) *(p)->cs |= (p)->csMask; } while (0)
+
+static volatile uint8_t elActive;				// Activity since last elPowerTick
+static uint16_t elIdleTicks;					// Ticks without activity
+
+#ifdef EL_STATS
+elstats elStats;
+#define EL_COUNT(counter)	(elStats.counter++)
+#else
+#define EL_COUNT(counter)
+#endif
 
 // *************************************************************
 // Sed 1330 Command Set 
@@ -101,73 +132,84 @@ static FILE myStdOut = FDEV_SETUP_STREAM(elPrintChar, NULL,_FDEV_SETUP_WRITE);
 /*********************************************************/
 /* send Command to Controller                            */
 /*********************************************************/
-void elSendCommand (unsigned char command) {
+void elSendCommand (elpanel *p, unsigned char command) {
 
-	while(elRead(BUSY));			// Check busy flag
+	while(elRead(p, BUSY));			// Check busy flag
+	EL_COUNT(commands);
 
-	EL_CTRL |= _BV(EL_A0);			// Sending command
-	EL_DATA  = command;
+	SELECT(p);
+	*p->ctrl |= _BV(EL_A0);			// Sending command
+	*p->data  = command;
 	
 	// Strobe write
 	_delay_us(STROBE_DELAY);
-	EL_CTRL &= ~_BV(EL_WR);
+	*p->ctrl &= ~_BV(EL_WR);
 	_delay_us(STROBE_DELAY);
-	EL_CTRL |=  _BV(EL_WR);
+	*p->ctrl |=  _BV(EL_WR);
 
-	EL_CTRL &= ~_BV(EL_A0);			// Return control to known state
+	*p->ctrl &= ~_BV(EL_A0);		// Return control to known state
+	DESELECT(p);
      
 }
 
 /*********************************************************/
 /* send byte to controller                               */
 /*********************************************************/
-void elSendByte (unsigned char value) {
+void elSendByte (elpanel *p, unsigned char value) {
 
-	while(elRead(BUSY));		// Check busy flag
+	while(elRead(p, BUSY));		// Check busy flag
+	EL_COUNT(writes);
  
-	EL_DATA = value;
+	SELECT(p);
+	*p->data = value;
 
 	// Strobe write
 	_delay_us(STROBE_DELAY);
-	EL_CTRL &= ~_BV(EL_WR);  
+	*p->ctrl &= ~_BV(EL_WR);  
 	_delay_us(STROBE_DELAY); 
-	EL_CTRL |=  _BV(EL_WR);
+	*p->ctrl |=  _BV(EL_WR);
+	DESELECT(p);
 
 }
 
 /*********************************************************/
 /* read data, cursor, or busy state from controller      */
 /*********************************************************/
-unsigned char elRead (int command) {
+unsigned char elRead (elpanel *p, int command) {
 
 	switch (command) {
 		case MREAD:
-			elSendCommand(MREAD);	// Read Data
-			EL_CTRL |= _BV(EL_A0);	// Set address line
+			elSendCommand(p, MREAD);	// Read Data
+			*p->ctrl |= _BV(EL_A0);		// Set address line
+			EL_COUNT(reads);
 			break;
 		case CSRR:
-			elSendCommand(CSRR);	// Read cursor
-			EL_CTRL |= _BV(EL_A0);	// Set address line
+			elSendCommand(p, CSRR);		// Read cursor
+			*p->ctrl |= _BV(EL_A0);		// Set address line
+			EL_COUNT(reads);
 			break;
 		case BUSY:
+			EL_COUNT(busyPolls);
 			break;
 		default:
 			return 0xFF;			// Error :(
 			break;
 	}
 	
-	DDR_DATA  =   0x00;			// Data lines as input
+	SELECT(p);
+	*p->dataDdr  =   0x00;		// Data lines as input
     
     // Strobe read
     _delay_us(STROBE_DELAY);
-	EL_CTRL &= ~_BV(EL_RD);	
+	*p->ctrl &= ~_BV(EL_RD);	
 	_delay_us(STROBE_DELAY);
-	unsigned char theByte = PIN_DATA;
-	EL_CTRL |= _BV(EL_RD);
+	unsigned char theByte = *p->dataPin;
+	*p->ctrl |= _BV(EL_RD);
 	
-	EL_CTRL &= ~_BV(EL_A0);			// Return control to known state
+	*p->ctrl &= ~_BV(EL_A0);		// Return control to known state
+	DESELECT(p);
 
-	DDR_DATA = 0xFF;			// Data lines as output
+	*p->dataDdr = 0xFF;			// Data lines as output
 	
 	if (command == BUSY) {
 		return !(theByte & 0x40); // STATUS reg bit 6 is 1 if we're clear to write.
@@ -180,23 +222,67 @@ unsigned char elRead (int command) {
 
 
 /*********************************************************/
-/* Reset Controller                                      */
+/* Bring bus pins into a known state                     */
+/*********************************************************/
+void elBusInit(elpanel *p) {
+
+	if (p->cs) {
+		*p->csDdr |= p->csMask;		// Chip select as output, not selected
+		DESELECT(p);
+	}
+
+	*p->dataDdr  = 0xFF;
+	*p->ctrlDdr |= (1 << EL_RD) | (1 << EL_WR) | (1 << EL_RESET) | (1 << EL_A1) | (1 << EL_A0); // Control pins as outputs
+
+	*p->ctrl |=  _BV(EL_RD);		// Not reading
+	*p->ctrl |=  _BV(EL_WR);		// Not writing
+
+	*p->ctrl &= ~(1 << EL_A0);
+	*p->ctrl &= ~(1 << EL_A1);
+}
+
+/*********************************************************/
+/* Reset Controllers. Panels sharing a control port get  */
+/* one common /RES pulse.                                */
 /*********************************************************/
-void elReset(void) {
+void elResetAll(elpanel **panels, uint8_t n, uint8_t fast) {
 
-	DDR_DATA  = 0xFF;
-	DDR_CTRL |= (1 << EL_RD) | (1 << EL_WR) | (1 << EL_RESET) | (1 << EL_A1) | (1 << EL_A0); // Control pins as outputs
+	uint8_t i;
 
-	EL_CTRL |=  _BV(EL_RD);		// Not reading
-	EL_CTRL |=  _BV(EL_WR);		// Not writing
+	for (i = 0; i < n; i++) {
+		elBusInit(panels[i]);
+		*panels[i]->ctrl &= ~_BV(EL_RESET);	// Assert reset
+	}
+
+	if (fast) {
+		_delay_us(EL_RESET_US);
+	} else {
+		_delay_ms(500);				// Wait 500ms
+	}
+
+	for (i = 0; i < n; i++) {
+		*panels[i]->ctrl |=  _BV(EL_RESET);
+	}
+
+	if (fast) {
+		_delay_ms(EL_RESET_SETTLE_MS);	// Let the oscillator start
+	}
+}
 
-	EL_CTRL &= ~(1 << EL_A0);
-	EL_CTRL &= ~(1 << EL_A1);
+/*********************************************************/
+/* Reset Controller                                      */
+/*********************************************************/
+void elReset(elpanel *p) {
+
+	elResetAll(&p, 1, 0);
+}
 
-	EL_CTRL &= ~_BV(EL_RESET);	// Assert reset
-	_delay_ms(500);				// Wait 500ms       
-    EL_CTRL |=  _BV(EL_RESET);
+/*********************************************************/
+/* Reset Controller with the shortest pulse it accepts   */
+/*********************************************************/
+void elResetFast(elpanel *p) {
 
+	elResetAll(&p, 1, 1);
 }
 
 /*********************************************************
@@ -205,166 +291,391 @@ void elReset(void) {
    needs to be changed to calculated values
    in future releases.
    Sorry - up to then you have to check maually
-   
+
+ Resetting one panel resets every panel on the same
+ control lines, so panels sharing them must be brought
+ up together with elInitAll.
 *********************************************************/
-void elInit(void) {
-	
-	EL_CTRL |= (1 << EL_RD) | (1 << EL_WR); // Not reading or writing
-	
-	// Reset Controller
-	elReset();
-
-	elSendCommand(SYSSET);
-	elSendByte(0x38);					// M0=0 (internal CG ROM), M1=0 (no D6 correction), M2=0 (8px char height), WS=1 (dual panel drive), IV=1
-	elSendByte((EL_CHARWIDTH-1)|0x80);	// Char width, WF=1 (two frame AC drive)
-	elSendByte(EL_CHARHEIGHT-1);    /* Char height             */
-	elSendByte(EL_CHARPERROW-1);    /* Chars per row           */
-	elSendByte((EL_CHARPERROW-1)+8);    
-	elSendByte((EL_CHARROWS * EL_CHARHEIGHT * 2) - 1);
-	elSendByte((32 & 0xff));	// APL	-- number of bytes per display line (low)
-	elSendByte((32 >> 8));	// APH	-- number of bytes per display line (high)
-
-	elSendCommand(OVERLAY);
-	elSendByte(0x01);                   /* XOR Simple Overlay was 1*/
-  
-	elSendCommand(SCROLL);
-	elSendByte(0x00);             /* Low  Byte Start Text Mem  */
-	elSendByte(0x00);             /* High Byte Start Text Mem  */
-	elSendByte(EL_RESX-1);    /* Screen Lines              */
-	elSendByte(0x00);          /* Low Byte Start Graph Mem  */
-	elSendByte(0x10);          /* High Byte Start Graph Mem */
-	elSendByte(EL_RESX-1);    /* Screen Lines              */
-	elSendByte(0x00);
-	elSendByte(0x04);
-	elSendByte(0x00);
-	elSendByte(0x30);
+void elInit(elpanel *p) {
+
+	elInitAll(&p, 1);
+}
+
+void elInitAll(elpanel **panels, uint8_t n) {
+
+	uint8_t i;
+
+	// Reset Controllers
+	elResetAll(panels, n, 0);
+
+	for (i = 0; i < n; i++) {
+		elSetup(panels[i]);
   
-	elSendCommand(CSRFORM);
-	elSendByte(0x5D);		// block cursor on
-	elSendByte(0x04);
-	elSendByte(0x86);
+		elSendCommand(panels[i], DISPON);     /* Display on*/
+		elSendByte(panels[i], 0x14);          /* Do not switch on Cursor ( messes up Graphics ) */
+
+		panels[i]->bootDone = 1;
+	}
+
+	elClearTextAll(panels, n);
+	elClearGraphAll(panels, n);
+ 
+}
+
+/*********************************************************
+ Fast Init
+ Uses the short reset and keeps the display off until
+ both layers hold defined content. bootText and
+ bootGraph point to complete layers in flash
+ (TEXTSIZE(p) and GRAPHSIZE(p) bytes) and are painted
+ right away. A layer passed as NULL is cleared by
+ elBootStep, which the caller interleaves with its own
+ boot work; the display comes on once it returns 0.
+ Panels sharing control lines must use elInitFastAll.
+*********************************************************/
+void elInitFast(elpanel *p, PGM_P bootText, PGM_P bootGraph) {
+
+	elInitFastAll(&p, 1, bootText, bootGraph);
+}
+
+void elInitFastAll(elpanel **panels, uint8_t n, PGM_P bootText, PGM_P bootGraph) {
+
+	uint8_t i;
+
+	elResetAll(panels, n, 1);
+
+	for (i = 0; i < n; i++) {
+		elpanel *p = panels[i];
+
+		elSetup(p);
+		p->bootDone = 0;
+		p->bootText = bootText ? 0 : TEXTSIZE(p);
+		p->bootGraph = bootGraph ? 0 : GRAPHSIZE(p);
+	}
 
-	elSendCommand(HDOTSCR);     /* Display on*/
-	elSendByte(0x0);            /* was 16Cursor FLash, first+second screen block on  */
+	// one boot image for all, so the panels share the first one's geometry
+	if (bootText) {
+		elPaintAll(panels, n, EL_TEXT_BASE, bootText, TEXTSIZE(panels[0]));
+	}
+	if (bootGraph) {
+		elPaintAll(panels, n, EL_GRAPH_BASE, bootGraph, GRAPHSIZE(panels[0]));
+	}
+
+	for (i = 0; i < n; i++) {
+		elBootStep(panels[i]);
+	}
+}
+
+/*********************************************************/
+/* Clear the next chunk of a layer elInitFast left       */
+/* undefined. Returns 0 once the display is on.          */
+/* Work between calls must not touch the panel: later    */
+/* chunks would overwrite anything drawn and the cursor  */
+/* is left mid-layer.                                    */
+/*********************************************************/
+uint8_t elBootStep(elpanel *p) {
+
+	uint16_t n;
+
+	if (p->bootText) {
+		n = (p->bootText < EL_BOOT_CHUNK) ? p->bootText : EL_BOOT_CHUNK;
+		elSetCursor(p, EL_TEXT_BASE + TEXTSIZE(p) - p->bootText);
+		elSendCommand(p, MWRITE);
+		for (p->bootText -= n; n; n--) {
+			elSendByte(p, ' ');
+		}
+	} else if (p->bootGraph) {
+		n = (p->bootGraph < EL_BOOT_CHUNK) ? p->bootGraph : EL_BOOT_CHUNK;
+		elSetCursor(p, EL_GRAPH_BASE + GRAPHSIZE(p) - p->bootGraph);
+		elSendCommand(p, MWRITE);
+		for (p->bootGraph -= n; n; n--) {
+			elSendByte(p, 0x00);
+		}
+	}
+
+	if (p->bootText || p->bootGraph) {
+		return 1;
+	}
+
+	if (!p->bootDone) {
+		elSendCommand(p, DISPON);
+		elSendByte(p, 0x14);
+		elCursorXY(p, 0,0);
+		p->bootDone = 1;
+	}
+	return 0;
+}
+
+/*********************************************************/
+/* Controller set up shared by elInit and elInitFast,    */
+/* leaves the display off                                */
+/*********************************************************/
+void elSetup(elpanel *p) {
+
+	fdev_setup_stream(&p->stream, elPrintChar, NULL, _FDEV_SETUP_WRITE);
+	fdev_set_udata(&p->stream, p);
+
+	p->asleep = 0;
+
+	elSysSet(p);
+
+	elSendCommand(p, OVERLAY);
+	elSendByte(p, 0x01);                   /* XOR Simple Overlay was 1*/
   
-	elSendCommand(CSRDIR);     /* No Param = shift right */
+	p->textBase  = EL_TEXT_BASE;
+	p->graphBase = EL_GRAPH_BASE;
+	memset(p->pageScreen, EL_SCREEN_NONE, sizeof(p->pageScreen));
+	p->cursorX = 0;
+	p->cursorY = 0;
+	p->textCursor = 0;
+
+	elSetScroll(p, EL_TEXT_BASE, EL_GRAPH_BASE, EL_TEXT_LOW, EL_GRAPH_LOW);
   
-	elSendCommand(DISPON);     /* Display on*/
-	elSendByte(0x14);          /* Do not switch on Cursor ( messes up Graphics ) */
+	elSendCommand(p, CSRFORM);
+	elSendByte(p, 0x5D);		// block cursor on
+	elSendByte(p, 0x04);
+	elSendByte(p, 0x86);
 
-	elClearText();
-	elClearGraph();
+	elSendCommand(p, HDOTSCR);     /* Display on*/
+	elSendByte(p, 0x0);            /* was 16Cursor FLash, first+second screen block on  */
+  
+	elSendCommand(p, CSRDIR);     /* No Param = shift right */
+}
 
-	stdout = &myStdOut;
- 
+/*********************************************************/
+/* Copy len bytes from flash to VRAM at addr             */
+/*********************************************************/
+void elPaint(elpanel *p, uint16_t addr, PGM_P src, uint16_t len) {
+
+	elPaintAll(&p, 1, addr, src, len);
+}
+
+/*********************************************************/
+/* System set up, also releases the controller from      */
+/* standby                                               */
+/*********************************************************/
+void elSysSet(elpanel *p) {
+
+	elSendCommand(p, SYSSET);
+	elSendByte(p, 0x38);					// M0=0 (internal CG ROM), M1=0 (no D6 correction), M2=0 (8px char height), WS=1 (dual panel drive), IV=1
+	elSendByte(p, (EL_CHARWIDTH-1)|0x80);	// Char width, WF=1 (two frame AC drive)
+	elSendByte(p, EL_CHARHEIGHT-1);    /* Char height             */
+	elSendByte(p, p->charPerRow-1);    /* Chars per row           */
+	elSendByte(p, (p->charPerRow-1)+8);    
+	elSendByte(p, (p->charRows * EL_CHARHEIGHT * 2) - 1);
+	elSendByte(p, (p->addrIncr & 0xff));	// APL	-- number of bytes per display line (low)
+	elSendByte(p, 0);					// APH	-- number of bytes per display line (high)
+}
+
+/*********************************************************/
+/* Set start addresses of the visible text and graphics  */
+/*********************************************************/
+void elSetScroll(elpanel *p, uint16_t textAddr, uint16_t graphAddr, uint16_t textLow, uint16_t graphLow) {
+
+	elSendCommand(p, SCROLL);
+	elSendByte(p, textAddr & 0xff);		/* Low  Byte Start Text Mem  */
+	elSendByte(p, textAddr >> 8);		/* High Byte Start Text Mem  */
+	elSendByte(p, (LINES(p) * 2) - 1);	/* Screen Lines              */
+	elSendByte(p, graphAddr & 0xff);	/* Low Byte Start Graph Mem  */
+	elSendByte(p, graphAddr >> 8);		/* High Byte Start Graph Mem */
+	elSendByte(p, (LINES(p) * 2) - 1);	/* Screen Lines              */
+	elSendByte(p, textLow & 0xff);		/* Lower screen text (SAD3)  */
+	elSendByte(p, textLow >> 8);
+	elSendByte(p, graphLow & 0xff);		/* Lower screen graph (SAD4) */
+	elSendByte(p, graphLow >> 8);
+
+	p->shownText = textAddr;
 }
 
 /*********************************************************/
 /* Set Graphics Cursor                                    */
 /*********************************************************/
-void elSetCursor(uint16_t addr) {
+void elSetCursor(elpanel *p, uint16_t addr) {
+
+	p->textCursor = 0;		// elCursorXY sets it again for text
 
 	// Command 0x46 -- Cursor Address Write
-	elSendCommand(CSRW);
-	elSendByte((addr & 0xff));
-	elSendByte((addr >> 8) & 0xff);
+	elSendCommand(p, CSRW);
+	elSendByte(p, (addr & 0xff));
+	elSendByte(p, (addr >> 8) & 0xff);
 }
 
-uint8_t elGetCursor(void) {
+uint8_t elGetCursor(elpanel *p) {
 
 	uint8_t addr, temp;
 
 	// Command 0x47 -- Cursor Address Read
-	temp = elRead(CSRR);
+	temp = elRead(p, CSRR);
 	addr = temp;
-	temp = elRead(CSRR);
+	temp = elRead(p, CSRR);
 	addr = addr + (temp << 8);
 
 	return addr;
 }
 
-void elCursorXY(int x, int y) {
+void elCursorXY(elpanel *p, int x, int y) {
 
 	uint16_t addr = 0;
 
-	if (x > EL_CHARPERROW) {
-		x = EL_CHARPERROW;
+	if (x > p->charPerRow) {
+		x = p->charPerRow;
 	}
 
-	if (y > EL_CHARROWS) {
-		y = EL_CHARROWS;
+	if (y > p->charRows) {
+		y = p->charRows;
 	}
 
-	addr = (y * EL_ADDR_INCR) + x;
+	addr = p->textBase + (y * p->addrIncr) + x;
+
+	elSetCursor(p, addr);
 
-	elSetCursor(addr);
+	p->cursorX = x;
+	p->cursorY = y;
+	p->textCursor = 1;
 }
 
 /*********************************************************/
 /* Text Clear Screen                                     */
 /*********************************************************/
-void elClearText(void) {
+void elClearText(elpanel *p) {
 
-	elCursorXY(0,0);
-	elSendCommand(DISPOFF);
-	elSendCommand(MWRITE);
-	for (uint16_t i = 0; i < (EL_ADDR_INCR*EL_CHARROWS); i++) {
-		elSendByte(' ');
-	}
-	
-	elCursorXY(0,0);
-	elSendCommand(DISPON);
+	elClearTextAll(&p, 1);
 }
 
 /*********************************************************/
 /* Graphic Clear Screen                                  */
 /*********************************************************/
-void elClearGraph(void) {
+void elClearGraph(elpanel *p) {
+
+	elClearGraphAll(&p, 1);
+}
+
+/*********************************************************/
+/* Clear text or graphics layer on several panels        */
+/*********************************************************/
+void elClearTextAll(elpanel **panels, uint8_t n) {
 
+	uint8_t i;
+
+	// only blank the displays if we are clearing what is on them
+	for (i = 0; i < n; i++) {
+		if (panels[i]->textBase == panels[i]->shownText) {
+			elSendCommand(panels[i], DISPOFF);
+		}
+	}
+
+	elFillAll(panels, n, 0, ' ');
+
+	for (i = 0; i < n; i++) {
+		elCursorXY(panels[i], 0,0);
+		if (panels[i]->textBase == panels[i]->shownText) {
+			elSendCommand(panels[i], DISPON);
+		}
+	}
+}
+
+void elClearGraphAll(elpanel **panels, uint8_t n) {
+
+	elFillAll(panels, n, 1, 0x00);
+}
+
+void elFillAll(elpanel **panels, uint8_t n, uint8_t graph, uint8_t value) {
+
+	uint16_t len = 0;
 	uint16_t x;
+	uint8_t i;
 
-	// move cursor to starting address of graphics page
-	elSetCursor(0x1000);
-	
-	// clear graphics screen with zeroes
-	elSendCommand(MWRITE);
-	for (x=0; x<XMAX; x++) {
-		elSendByte(0x00);
+	// move every cursor to the start of its layer
+	for (i = 0; i < n; i++) {
+		elpanel *p = panels[i];
+		uint16_t size = graph ? GRAPHSIZE(p) : TEXTSIZE(p);
+
+		elSetCursor(p, graph ? p->graphBase : p->textBase);
+		elSendCommand(p, MWRITE);
+		if (size > len) {
+			len = size;
+		}
+	}
+
+	// each controller stays in MWRITE while the others are written
+	for (x = 0; x < len; x++) {
+		for (i = 0; i < n; i++) {
+			if (x < (graph ? GRAPHSIZE(panels[i]) : TEXTSIZE(panels[i]))) {
+				elSendByte(panels[i], value);
+			}
+		}
+	}
+}
+
+/*********************************************************/
+/* Copy len bytes from flash to VRAM at addr on several  */
+/* panels, reading each byte from flash only once        */
+/*********************************************************/
+void elPaintAll(elpanel **panels, uint8_t n, uint16_t addr, PGM_P src, uint16_t len) {
+
+	uint8_t i;
+
+	for (i = 0; i < n; i++) {
+		elSetCursor(panels[i], addr);
+		elSendCommand(panels[i], MWRITE);
+	}
+
+	while (len--) {
+		uint8_t value = pgm_read_byte(src++);
+
+		for (i = 0; i < n; i++) {
+			elSendByte(panels[i], value);
+		}
 	}
 }
 
 /*********************************************************/
 /* Print a null terminated string at x,y                 */
 /*********************************************************/
-void elWriteStr0(unsigned char *myText) {
+void elWriteStr0(elpanel *p, unsigned char *myText) {
 	while (*myText)
-		elChar(*myText++);
+		elChar(p, *myText++);
 
 }
 
 /*********************************************************/
 /* Print a char 						                */
 /*********************************************************/
-void elChar(unsigned char myText) {
-	elSendCommand(MWRITE);
-	elSendByte(myText);
+void elChar(elpanel *p, unsigned char myText) {
+
+	// drawing or a page switch moved the controller's cursor,
+	// carry on where the text left off
+	if (!p->textCursor) {
+		elSetCursor(p, p->textBase + (p->cursorY * p->addrIncr) + p->cursorX);
+		p->textCursor = 1;
+	}
+
+	elSendCommand(p, MWRITE);
+	elSendByte(p, myText);
+
+	// the controller just steps to the next address, which
+	// wraps to the next line after addrIncr characters
+	if (++p->cursorX == p->addrIncr) {
+		p->cursorX = 0;
+		p->cursorY++;
+	}
 }
 
 /*********************************************************/
 /* Set/Reset Pixel                                       */
 /*********************************************************/
-void elPixel(int x, int y, drawmode show) {
+void elPixel(elpanel *p, int x, int y, drawmode show) {
 
 	uint16_t addr, ch;
 
 	// calculate address
-	addr = 0x1000 + (y * EL_ADDR_INCR) + (x / EL_CHARWIDTH);
+	addr = p->graphBase + (y * p->addrIncr) + (x / EL_CHARWIDTH);
 
 	// send address
-	elSetCursor(addr);
+	elSetCursor(p, addr);
 	
 	// read current pixel state
-	ch = elRead(MREAD);
+	ch = elRead(p, MREAD);
 	if ( (show == on) || (show == fill) ) {
 		ch |= 1<<(7-(x % EL_CHARWIDTH));
 	} else {
@@ -372,11 +683,11 @@ void elPixel(int x, int y, drawmode show) {
 	}
 
 	// send address again
-	elSetCursor(addr);
+	elSetCursor(p, addr);
 	
 	// update pixel state
-	elSendCommand(MWRITE);
-	elSendByte(ch);
+	elSendCommand(p, MWRITE);
+	elSendByte(p, ch);
 }
 
 
@@ -384,20 +695,20 @@ void elPixel(int x, int y, drawmode show) {
 /* Draws a rectangle from x1,y1 to x2,y2.                                   */
 /* Thank you  Knut Baardsen @ Baardsen Software, Norway http://www.baso.no  */
 /****************************************************************************/
-void elRectangle(int x1,int y1,int x2,int y2,drawmode show) {
+void elRectangle(elpanel *p, int x1,int y1,int x2,int y2,drawmode show) {
 
 	int i;
 	for (i=x1; i<=x2; i++) 
-		elPixel(i,y1, show);
+		elPixel(p, i,y1, show);
 	for (i=x1; i<=x2; i++) 
-		elPixel(i,y2, show); 
+		elPixel(p, i,y2, show); 
 	for (i=y1; i<=y2; i++) 
-		elPixel(x1,i, show);
+		elPixel(p, x1,i, show);
 	for (i=y1; i<=y2; i++) 
-		elPixel(x2,i, show);
+		elPixel(p, x2,i, show);
 	if ( (show == fill)||(show == clear) ) {
 		for (i=y1; i<=y2; i++) 
-			elLine(x1,i,x2,i, show);
+			elLine(p, x1,i,x2,i, show);
 	} 
 }
 
@@ -405,14 +716,14 @@ void elRectangle(int x1,int y1,int x2,int y2,drawmode show) {
 /* Draws a line from x,y at given degree from inner_radius to outer_radius. */
 /* Thank you  Knut Baardsen @ Baardsen Software, Norway http://www.baso.no  */
 /****************************************************************************/
-void elDegreeLine(int x,int y, int degree, int inner_radius, int outer_radius, drawmode show) {
+void elDegreeLine(elpanel *p, int x,int y, int degree, int inner_radius, int outer_radius, drawmode show) {
 
 	int fx,fy,tx,ty;
 	fx = x + (inner_radius * sin(degree * 3.14 / 180));
 	fy = y - (inner_radius * cos(degree * 3.14 / 180));
 	tx = x + (outer_radius * sin(degree * 3.14 / 180));
 	ty = y - (outer_radius * cos(degree * 3.14 / 180));
-	elLine(fx,fy,tx,ty,show);
+	elLine(p, fx,fy,tx,ty,show);
 }
 
 /****************************************************************************/
@@ -420,24 +731,24 @@ void elDegreeLine(int x,int y, int degree, int inner_radius, int outer_radius, d
 /* Set show to 1 to draw pixel, set to 0 to hide pixel.                     */
 /* Thank you  Knut Baardsen @ Baardsen Software, Norway http://www.baso.no  */
 /****************************************************************************/
-void elCircle(int x, int y, int radius, drawmode  show) {
+void elCircle(elpanel *p, int x, int y, int radius, drawmode  show) {
 
 	int xc = 0;
 	int yc = radius;
-	int p = 3 - (radius<<1);
+	int d = 3 - (radius<<1);
 	while (xc <= yc)   {
-		elPixel(x + xc, y + yc, show);
-		elPixel(x + xc, y - yc, show);
-		elPixel(x - xc, y + yc, show);
-		elPixel(x - xc, y - yc, show);
-		elPixel(x + yc, y + xc, show);
-		elPixel(x + yc, y - xc, show);
-		elPixel(x - yc, y + xc, show);
-		elPixel(x - yc, y - xc, show);
-		if (p < 0) {
-			p += (xc++ << 2) + 6;
+		elPixel(p, x + xc, y + yc, show);
+		elPixel(p, x + xc, y - yc, show);
+		elPixel(p, x - xc, y + yc, show);
+		elPixel(p, x - xc, y - yc, show);
+		elPixel(p, x + yc, y + xc, show);
+		elPixel(p, x + yc, y - xc, show);
+		elPixel(p, x - yc, y + xc, show);
+		elPixel(p, x - yc, y - xc, show);
+		if (d < 0) {
+			d += (xc++ << 2) + 6;
 		} else {
-			p += ((xc++ - yc--)<<2) + 10;
+			d += ((xc++ - yc--)<<2) + 10;
 		}
 	}
 }
@@ -447,7 +758,7 @@ void elCircle(int x, int y, int radius, drawmode  show) {
 /* Draws a line from x1,y1 go x2,y2. Line can be drawn in any direction.    */
 /* Thank you  Knut Baardsen @ Baardsen Software, Norway http://www.baso.no  */
 /****************************************************************************/
-void elLine(int x1, int y1, int x2, int y2, drawmode show)  {
+void elLine(elpanel *p, int x1, int y1, int x2, int y2, drawmode show)  {
 
 	int dy = y2 - y1;
 	int dx = x2 - x1;
@@ -467,7 +778,7 @@ void elLine(int x1, int y1, int x2, int y2, drawmode show)  {
 	
 	dy <<= 1;
 	dx <<= 1;
-	elPixel(x1,y1,show);
+	elPixel(p, x1,y1,show);
 
 	if (dx > dy) {
 		fraction = dy - (dx >> 1); 
@@ -479,7 +790,7 @@ void elLine(int x1, int y1, int x2, int y2, drawmode show)  {
 			
 			x1 += stepx;
 			fraction += dy;  
-			elPixel(x1,y1,show);
+			elPixel(p, x1,y1,show);
 		}
 		
 	} else {
@@ -492,7 +803,7 @@ void elLine(int x1, int y1, int x2, int y2, drawmode show)  {
 
 			y1 += stepy;
 			fraction += dx;
-			elPixel(x1,y1,show);
+			elPixel(p, x1,y1,show);
 		}
 	}
 }
@@ -505,49 +816,52 @@ void elLine(int x1, int y1, int x2, int y2, drawmode show)  {
 
 static int elPrintChar(char myChar, FILE *stream) {  
 
-	stream = NULL;
-	elChar(myChar);
+	elChar(fdev_get_udata(stream), myChar);
 	return 0;
 }
 
 /*********************************************************/
 /* Read touchscreen, returns row and col concatenated to a 16bit int */
 /*********************************************************/
-uint16_t elTouchscreenRead(void) {
+uint16_t elTouchscreenRead(elpanel *p) {
 
 	uint8_t col, row;
 
+	SELECT(p);
+
 	// set address pins to read column address
-	EL_CTRL |= (1 << EL_A1);
-	EL_CTRL &= ~(1 << EL_A0);
+	*p->ctrl |= (1 << EL_A1);
+	*p->ctrl &= ~(1 << EL_A0);
 	
-	DDR_DATA  =   0x00;			// Data lines as input
-	//EL_DATA = 0xFF;				// Pullups
+	*p->dataDdr  =   0x00;		// Data lines as input
+	//*p->data = 0xFF;			// Pullups
     
     // Initiate read
     _delay_us(STROBE_DELAY);
-	EL_CTRL &= ~(1 << EL_RD);
+	*p->ctrl &= ~(1 << EL_RD);
 	_delay_us(STROBE_DELAY);
 	
 	// Get column
-	col = (PIN_DATA & 0x3F);
+	col = (*p->dataPin & 0x3F);
 	
 	// Change address pins (without changing RD)
-	EL_CTRL |= (1 << EL_A1) | (1 << EL_A0);
+	*p->ctrl |= (1 << EL_A1) | (1 << EL_A0);
 	_delay_us(STROBE_DELAY);
 
 	// Get row
-	row = (PIN_DATA & 0x07);
+	row = (*p->dataPin & 0x07);
 	_delay_us(STROBE_DELAY);
 	
 	// Done reading
-	EL_CTRL |= (1 << EL_RD);
+	*p->ctrl |= (1 << EL_RD);
 
-	EL_CTRL &= ~(1 << EL_A1);
-	EL_CTRL &= ~(1 << EL_A0);
+	*p->ctrl &= ~(1 << EL_A1);
+	*p->ctrl &= ~(1 << EL_A0);
 	
-	//EL_DATA = 0x00;				// No pullups
-	DDR_DATA = 0xFF;			// Data lines as output
+	//*p->data = 0x00;			// No pullups
+	*p->dataDdr = 0xFF;			// Data lines as output
+
+	DESELECT(p);
 
 	// was there a touch?
 	if ((col == 0x3F) && (row == 0x07)) {
@@ -570,3 +884,207 @@ uint16_t elTouchscreenRead(void) {
 
 }
 
+/*********************************************************/
+/* Power management                                      */
+/*                                                       */
+/* In standby the controller keeps its registers and     */
+/* VRAM, so waking only needs SYSSET and DISPON instead  */
+/* of the full elInit with its 500ms reset.              */
+/*********************************************************/
+void elSleep(elpanel *p) {
+
+	elSendCommand(p, DISPOFF);
+	elSendCommand(p, SLEEPIN);
+	p->asleep = 1;
+}
+
+void elWake(elpanel *p) {
+
+	if (!p->asleep) {
+		return;
+	}
+
+	elSysSet(p);					// SYSSET releases standby
+	_delay_ms(EL_RESET_SETTLE_MS);	// oscillator was stopped by SLEEPIN
+	elSendCommand(p, DISPON);
+	elSendByte(p, 0x14);
+	p->asleep = 0;
+}
+
+// Only sets a flag, so it is safe from the touch ISR even
+// while the main loop is half way through a bus transaction.
+// The panels are woken by the next elPowerTick.
+void elPowerActivity(void) {
+
+	elActive = 1;
+}
+
+void elPowerTick(elpanel **panels, uint8_t n) {
+
+	uint8_t i;
+
+	if (!elActive) {
+		if (++elIdleTicks < EL_IDLE_TICKS) {
+			return;
+		}
+
+		// INT0 must be level triggered to wake from power-down
+		set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+		cli();
+		if (!elActive) {
+			for (i = 0; i < n; i++) {
+				elSleep(panels[i]);
+			}
+			sleep_enable();
+			sei();					// sei + sleep run back to back, no touch is missed
+			sleep_cpu();
+			sleep_disable();
+		}
+		sei();
+	}
+
+	// touch seen or back from power-down
+	for (i = 0; i < n; i++) {
+		elWake(panels[i]);
+	}
+	elActive = 0;
+	elIdleTicks = 0;
+}
+
+/*********************************************************/
+/* Off-screen page cache                                 */
+/*                                                       */
+/* Frequently used screens are drawn once into spare     */
+/* VRAM pages and later shown by reprogramming SCROLL,   */
+/* so no display data has to cross the bus.              */
+/*********************************************************/
+uint16_t elPageBase(int8_t page) {
+
+	if ((page < 0) || (page >= (int8_t)EL_PAGES)) {
+		return 0;	// live screen
+	}
+	return EL_CACHE_BASE + (page * EL_SCREEN_SPAN);
+}
+
+int8_t elPageFind(elpanel *p, uint8_t screen) {
+
+	for (int8_t page = 0; page < (int8_t)EL_PAGES; page++) {
+		if (p->pageScreen[page] == screen) {
+			return page;
+		}
+	}
+	return EL_PAGE_LIVE;
+}
+
+int8_t elPageAlloc(elpanel *p, uint8_t screen) {
+
+	if (screen == EL_SCREEN_NONE) {
+		return EL_PAGE_LIVE;
+	}
+
+	int8_t page = elPageFind(p, screen);
+
+	if (page == EL_PAGE_LIVE) {
+		page = elPageFind(p, EL_SCREEN_NONE);	// first free page
+		if (page != EL_PAGE_LIVE) {
+			p->pageScreen[page] = screen;
+		}
+	}
+	return page;
+}
+
+void elPageFree(elpanel *p, uint8_t screen) {
+
+	int8_t page = elPageFind(p, screen);
+
+	if ((screen == EL_SCREEN_NONE) || (page == EL_PAGE_LIVE)) {
+		return;
+	}
+
+	p->pageScreen[page] = EL_SCREEN_NONE;
+
+	// don't leave the display or drawing on a page that can be handed out again
+	uint16_t text = elPageBase(page) + EL_TEXT_BASE;
+
+	if (p->shownText == text) {
+		elPageShow(p, EL_PAGE_LIVE);
+	}
+	if (p->textBase == text) {
+		elPageSelect(p, EL_PAGE_LIVE);
+	}
+}
+
+void elPageSelect(elpanel *p, int8_t page) {
+
+	uint16_t base = elPageBase(page);
+
+	p->graphBase = base + EL_GRAPH_BASE;
+	p->textBase  = base + EL_TEXT_BASE;
+}
+
+void elPageShow(elpanel *p, int8_t page) {
+
+	uint16_t base = elPageBase(page);
+
+	elSetScroll(p, base + EL_TEXT_BASE, base + EL_GRAPH_BASE,
+				base + EL_TEXT_LOW, base + EL_GRAPH_LOW);
+}
+
+#ifdef EL_STATS
+/*********************************************************/
+/* Bus statistics                                        */
+/*********************************************************/
+void elStatsReset(void) {
+
+	memset(&elStats, 0, sizeof(elStats));
+}
+
+// Bus-only estimate: two STROBE_DELAY waits per transaction
+// plus the code around them. The overheads are hand counts of
+// what avr-gcc -Os makes of elSendCommand, elSendByte and elRead
+// (call/return, register saves, ld/st through the panel pointers,
+// /CS test), without the EL_STATS counting itself. They are not
+// measured; re-count them from a disassembly when that code
+// changes. Drawing arithmetic is not included.
+#define EL_CYCLES_COMMAND	80		// elSendCommand, busy poll excluded
+#define EL_CYCLES_WRITE		60		// elSendByte, busy poll excluded
+#define EL_CYCLES_READ		95		// elRead of MREAD/CSRR, its command excluded
+#define EL_CYCLES_POLL		90		// elRead of BUSY and the while around it
+
+uint32_t elStatsCycles(void) {
+
+	uint32_t strobes = elStats.commands + elStats.writes + elStats.reads + elStats.busyPolls;
+
+	return (strobes * 2 * STROBE_DELAY * (F_CPU / 1000000UL))
+		+ (elStats.commands * EL_CYCLES_COMMAND)
+		+ (elStats.writes * EL_CYCLES_WRITE)
+		+ (elStats.reads * EL_CYCLES_READ)
+		+ (elStats.busyPolls * EL_CYCLES_POLL);
+}
+
+/*********************************************************/
+/* Dump graphics layer as plain PBM, one row per line.   */
+/* Its own reads are kept out of elStats.                */
+/*********************************************************/
+void elDumpPBM(elpanel *p, FILE *out) {
+
+	elstats saved = elStats;
+
+	fprintf(out, "P1\n%d %d\n", p->resX, LINES(p));
+
+	for (int y = 0; y < LINES(p); y++) {
+		elSetCursor(p, p->graphBase + (y * p->addrIncr));
+		for (int i = 0; i < p->charPerRow; i++) {
+			uint8_t bits = elRead(p, MREAD);
+			for (int b = 0; b < EL_CHARWIDTH; b++) {
+				if ((i * EL_CHARWIDTH) + b < p->resX) {
+					fputc((bits & (1<<(7-b))) ? '1' : '0', out);
+				}
+			}
+		}
+		fputc('\n', out);
+	}
+
+	elStats = saved;
+}
+#endif
@@ -1,5 +1,8 @@
 #ifndef PLANARTOUCH_H
 #define PLANARTOUCH_H
+
+#include <stdio.h>
+#include <avr/pgmspace.h>
 // *******************************************************
 //
 // Software library for driving Planar EL160.80.38-SM1
@@ -65,6 +68,13 @@
 // connected to Port B, the control lines on Port C,
 // and the /INT line connected to INT0 (PD2).
 //
+// Ports are only referenced through EL_PANEL() below, so
+// several displays can be driven by giving each one its own
+// elpanel. Displays may share data and control lines when
+// each has its own /CS (EL_PANEL_CS); they share /RES too, so
+// bring them up with elInitAll or elInitFastAll, never one by
+// one. The control pin numbers are the same on every panel.
+//
 // *************************************************************
 #define EL_DATA			PORTB	/* EL Data Port, Port B */
 #define PIN_DATA		PINB      
@@ -84,16 +94,53 @@
 
 #define STROBE_DELAY	1		// Delay (in uS) for strobing data in and out.
 
+// elResetFast assumes VDD is already stable when the MCU starts
+// running, which the AVR start-up delay (SUT fuses) and BOD
+// take care of, so no extra power-on wait is needed.
+#define EL_RESET_US			200	// /RES low time for elResetFast, SED1330 minimum once VDD is stable
+#define EL_RESET_SETTLE_MS	3	// Oscillator start-up after releasing /RES or leaving SLEEPIN
+#define EL_BOOT_CHUNK		64	// Bytes cleared per elBootStep call
+
 #define EL_RESX			160		/* EL X resolution */
 #define EL_RESY			80		/* EL Y resolution */
 #define EL_CHARPERROW	27		/* maximum is ( EL_RESX / EL_CHARWIDTH ) */
 #define EL_CHARROWS		10		/* should be calculated from RESY/CHARHEIGHT */
 #define EL_CHARWIDTH	6		/* = EL_RESX / EL_CHARPERROW */
-#define EL_CHARHEIGHT	8
+#define EL_CHARHEIGHT	8		/* Char cell is fixed at build time for every panel, so elPixel divides by a constant */
 #define EL_ADDR_INCR 32
 
 #define XMAX (EL_ADDR_INCR * EL_CHARROWS * EL_CHARHEIGHT)
 
+#define EL_IDLE_TICKS	3000	/* elPowerTick calls without activity before powering down */
+
+// *************************************************************
+// VRAM layout
+//
+// With WS=1 the panel is driven as an upper and a lower half,
+// each EL_CHARROWS * EL_CHARHEIGHT lines (SL1/SL2) of
+// EL_ADDR_INCR bytes per layer. The upper half comes from
+// EL_TEXT_BASE / EL_GRAPH_BASE, the lower half from EL_TEXT_LOW /
+// EL_GRAPH_LOW (SAD3/SAD4); the driver draws to and clears the
+// upper half only, as it always has.
+//
+// An off-screen page is this whole address map moved up by a
+// multiple of EL_SCREEN_SPAN, starting at EL_CACHE_BASE, so the
+// lower half sits at the same offsets on every screen. 32K of
+// VRAM leaves room for one page, 64K for three. Lower or raise
+// EL_VRAM_END to match the SRAM fitted to your module.
+// *************************************************************
+#define EL_TEXT_BASE	0x0000	/* Text layer, upper half				*/
+#define EL_GRAPH_BASE	0x1000	/* Graphics layer, upper half			*/
+#define EL_TEXT_LOW		0x0400	/* Text layer, lower half (SAD3)		*/
+#define EL_GRAPH_LOW	0x3000	/* Graphics layer, lower half (SAD4)	*/
+#define EL_SCREEN_SPAN	0x4000	/* VRAM taken by one screen's address map */
+
+#define EL_CACHE_BASE	EL_SCREEN_SPAN	/* First page, right after the live screen */
+#define EL_VRAM_END		0x8000UL	/* One past the last VRAM byte (32K)	*/
+#define EL_PAGES		((EL_VRAM_END - EL_CACHE_BASE) / EL_SCREEN_SPAN)
+#define EL_PAGE_LIVE	-1		/* Page number of the live screen		*/
+#define EL_SCREEN_NONE	0		/* Screen id marking a free page		*/
+
 
 // *************************************************************
 // Types 
@@ -106,25 +153,121 @@ typedef enum DrawMode {
 } 
 drawmode;
 
+// One display: wiring, geometry and everything the driver
+// remembers about it. Set up with EL_PANEL or EL_PANEL_CS.
+typedef struct Panel {
+	volatile uint8_t *data;		// Data port (PORTx)
+	volatile uint8_t *dataPin;	// Data input (PINx)
+	volatile uint8_t *dataDdr;	// Data direction (DDRx)
+	volatile uint8_t *ctrl;		// Control port, pins EL_RD..EL_A0
+	volatile uint8_t *ctrlDdr;
+	volatile uint8_t *cs;		// Chip select port, NULL if /CS is tied low
+	volatile uint8_t *csDdr;
+	uint8_t csMask;				// Chip select pin (as bit mask)
+
+	uint16_t resX;				// Geometry, see EL_RESX etc. The char cell is EL_CHARWIDTH x EL_CHARHEIGHT on every panel
+	uint8_t charPerRow;
+	uint8_t charRows;
+	uint8_t addrIncr;
+
+	uint16_t textBase;			// Text layer drawn to
+	uint16_t graphBase;			// Graphics layer drawn to
+	uint16_t shownText;			// Text layer currently displayed
+
+	uint8_t cursorX;			// Text cursor, column and row of the next elChar
+	uint8_t cursorY;
+	uint8_t textCursor;			// Controller cursor still sits at cursorX, cursorY
+	uint8_t pageScreen[EL_PAGES];	// Screen held by each off-screen page
+
+	volatile uint8_t asleep;	// Controller is in standby
+
+	uint16_t bootText;			// Text bytes elBootStep still has to clear
+	uint16_t bootGraph;			// Graphics bytes elBootStep still has to clear
+	uint8_t bootDone;			// Display switched on after elInitFast
+
+	FILE stream;				// stdio stream printing to this panel, set stdout = &panel.stream to use it
+}
+elpanel;
+
+#define EL_PANEL(port, pin, ddr, ctrlPort, ctrlDdrReg) {	\
+	.data = &(port), .dataPin = &(pin), .dataDdr = &(ddr),		\
+	.ctrl = &(ctrlPort), .ctrlDdr = &(ctrlDdrReg),				\
+	.resX = EL_RESX, .charPerRow = EL_CHARPERROW,				\
+	.charRows = EL_CHARROWS, .addrIncr = EL_ADDR_INCR }
+
+#define EL_PANEL_CS(port, pin, ddr, ctrlPort, ctrlDdrReg, csPort, csDdrReg, csBit) {	\
+	.data = &(port), .dataPin = &(pin), .dataDdr = &(ddr),		\
+	.ctrl = &(ctrlPort), .ctrlDdr = &(ctrlDdrReg),				\
+	.cs = &(csPort), .csDdr = &(csDdrReg), .csMask = _BV(csBit),	\
+	.resX = EL_RESX, .charPerRow = EL_CHARPERROW,				\
+	.charRows = EL_CHARROWS, .addrIncr = EL_ADDR_INCR }
+
+#ifdef EL_STATS
+typedef struct BusStats {
+	uint32_t commands;	// command bytes written
+	uint32_t writes;	// data bytes written
+	uint32_t reads;		// data and cursor bytes read
+	uint32_t busyPolls;	// status reads spent waiting on the controller
+}
+elstats;
+#endif
+
 
 // *************************************************************
 // User Functions 
 // *************************************************************
 
-void elInit (void);			/* Initialize Display Controler */
-void elReset(void);			/* Reset Display Controler.     */
-void elClearText(void);		/* Clear Text Screen    */
-void elWriteStr0(unsigned char *myText);
-void elCursorXY(int x, int y);
-void elChar(unsigned char myChar);
-static int elPrintChar(char myChar, FILE *stream);	/* for using STDIO in avr-libc */
-
-void elClearGraph(void);							/* Clear Graphic Screen */
-void elPixel (int x,int y, drawmode show);
-void elLine  (int x1, int y1, int x2, int y2, drawmode show);
-void elCircle(int x, int y, int radius, drawmode show);
-void elRectangle (int x1,int y1,int x2,int y2,drawmode show);
-void elDegreeLine(int x,int y, int degree, int inner_radius, int outer_radius, drawmode show);
-uint16_t elTouchscreenRead(void);
+void elInit (elpanel *p);			/* Initialize Display Controler */
+void elInitAll(elpanel **panels, uint8_t n);	/* Initialize panels sharing control lines with one reset */
+void elReset(elpanel *p);			/* Reset Display Controler.     */
+void elInitFast(elpanel *p, PGM_P bootText, PGM_P bootGraph);	/* Short reset, optionally paint boot screen from flash */
+void elInitFastAll(elpanel **panels, uint8_t n, PGM_P bootText, PGM_P bootGraph);	/* elInitFast for panels sharing control lines */
+void elResetFast(elpanel *p);		/* Reset with minimum pulse     */
+uint8_t elBootStep(elpanel *p);	/* Finish elInitFast, 0 when display is on. Don't draw before that */
+void elPaint(elpanel *p, uint16_t addr, PGM_P src, uint16_t len);	/* Copy flash to VRAM */
+void elClearText(elpanel *p);		/* Clear Text Screen    */
+void elWriteStr0(elpanel *p, unsigned char *myText);
+void elCursorXY(elpanel *p, int x, int y);
+void elChar(elpanel *p, unsigned char myChar);
+
+void elClearGraph(elpanel *p);							/* Clear Graphic Screen */
+void elPixel (elpanel *p, int x,int y, drawmode show);
+void elLine  (elpanel *p, int x1, int y1, int x2, int y2, drawmode show);
+void elCircle(elpanel *p, int x, int y, int radius, drawmode show);
+void elRectangle (elpanel *p, int x1,int y1,int x2,int y2,drawmode show);
+void elDegreeLine(elpanel *p, int x,int y, int degree, int inner_radius, int outer_radius, drawmode show);
+uint16_t elTouchscreenRead(elpanel *p);
+
+// Bulk writes to several panels, one byte to each in turn so
+// every controller works on its byte while the others are fed.
+void elClearTextAll(elpanel **panels, uint8_t n);
+void elClearGraphAll(elpanel **panels, uint8_t n);
+void elPaintAll(elpanel **panels, uint8_t n, uint16_t addr, PGM_P src, uint16_t len);
+
+void elSleep(elpanel *p);				/* Put controller into standby */
+void elWake(elpanel *p);				/* Resume controller from standby, VRAM is kept */
+void elPowerActivity(void);				/* Restart idle timeout, safe from ISRs */
+void elPowerTick(elpanel **panels, uint8_t n);	/* Call periodically from the main loop, powers down after EL_IDLE_TICKS idle ticks and wakes the panels on activity */
+
+int8_t elPageAlloc(elpanel *p, uint8_t screen);	/* Reserve an off-screen page for screen, -1 if VRAM is full or screen is EL_SCREEN_NONE */
+int8_t elPageFind(elpanel *p, uint8_t screen);	/* Page holding screen, -1 if not cached */
+void elPageFree(elpanel *p, uint8_t screen);	/* Release the page holding screen, falls back to the live screen if it was shown */
+void elPageSelect(elpanel *p, int8_t page);		/* Direct drawing to page (EL_PAGE_LIVE for the live screen) */
+void elPageShow(elpanel *p, int8_t page);		/* Make page visible by moving the SCROLL start addresses */
+
+// *************************************************************
+// Bus statistics. Build with -DEL_STATS to count every
+// transaction on the controller bus, e.g. to compare drawing
+// primitives before and after a change. elDumpPBM writes the
+// graphics layer being drawn to as a plain PBM image so two
+// builds can be checked for pixel-identical output.
+// *************************************************************
+#ifdef EL_STATS
+extern elstats elStats;
+
+void elStatsReset(void);				/* Zero all counters */
+uint32_t elStatsCycles(void);			/* Estimated CPU cycles of bus I/O since reset, drawing code not included */
+void elDumpPBM(elpanel *p, FILE *out);				/* Write graphics layer to out as PBM (P1) */
+#endif
 
 #endif
@@ -0,0 +1,9 @@
+// Host stand-in for <avr/interrupt.h>
+#ifndef _AVR_INTERRUPT_H_
+#define _AVR_INTERRUPT_H_
+
+#define cli()
+#define sei()
+#define ISR(vector)	void vector(void)
+
+#endif
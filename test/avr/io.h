@@ -0,0 +1,19 @@
+// Host stand-in for <avr/io.h>, see fakeBus.c
+#ifndef _AVR_IO_H_
+#define _AVR_IO_H_
+
+#include <stdint.h>
+
+extern volatile uint8_t PORTB, PINB, DDRB;
+extern volatile uint8_t PORTC, PINC, DDRC;
+extern volatile uint8_t PORTD, PIND, DDRD;
+extern volatile uint8_t EICRA, EIMSK;
+
+#define _BV(bit)	(1 << (bit))
+
+#define INT0		0
+#define INT1		1
+#define ISC00		0
+#define ISC01		1
+
+#endif
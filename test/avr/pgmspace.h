@@ -0,0 +1,11 @@
+// Host stand-in for <avr/pgmspace.h>, flash is ordinary memory here
+#ifndef _AVR_PGMSPACE_H_
+#define _AVR_PGMSPACE_H_
+
+#include <stdint.h>
+
+#define PROGMEM
+#define PGM_P				const char *
+#define pgm_read_byte(addr)	(*(const uint8_t *)(addr))
+
+#endif
@@ -0,0 +1,13 @@
+// Host stand-in for <avr/sleep.h>, sleeping returns at once
+#ifndef _AVR_SLEEP_H_
+#define _AVR_SLEEP_H_
+
+#define SLEEP_MODE_IDLE		0
+#define SLEEP_MODE_PWR_DOWN	2
+
+#define set_sleep_mode(mode)
+#define sleep_enable()
+#define sleep_disable()
+#define sleep_cpu()
+
+#endif
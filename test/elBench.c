@@ -0,0 +1,377 @@
+// *******************************************************
+//
+// Host benchmark and regression run for the planarTouch
+// drawing primitives (make test).
+//
+// Each case draws onto a cleared screen of the fake
+// SED1330 in fakeBus.c, reports the bus transactions it
+// took and elStatsCycles' estimate of the ATmega cycles the
+// bus I/O cost (drawing arithmetic not included), then
+// compares the graphics layer (and for text cases the text
+// layer) against the golden files in test/golden.
+//
+// After the cases, the SCROLL addresses of the page cache
+// are checked, and two panels sharing the bus behind their
+// own /CS are driven together to check every byte lands on
+// the panel it was meant for.
+//
+// 	elBench [-u] <golden dir>
+//
+// -u rewrites the golden files from the current output.
+//
+// *******************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "planarTouch.h"
+#include "fakeBus.h"
+
+static elpanel display = EL_PANEL(EL_DATA, PIN_DATA, DDR_DATA, EL_CTRL, DDR_CTRL);
+static elpanel left  = EL_PANEL_CS(EL_DATA, PIN_DATA, DDR_DATA, EL_CTRL, DDR_CTRL, PORTD, DDRD, 6);
+static elpanel right = EL_PANEL_CS(EL_DATA, PIN_DATA, DDR_DATA, EL_CTRL, DDR_CTRL, PORTD, DDRD, 7);
+
+static void drawPixel(elpanel *p) {
+
+	for (int i = 0; i < 40; i++) {
+		elPixel(p, 3 * i, i, on);
+		elPixel(p, 159 - i, 2 * i, on);
+	}
+	elPixel(p, 30, 10, off);
+}
+
+static void drawLine(elpanel *p) {
+
+	elLine(p, 0, 0, 159, 79, on);
+	elLine(p, 159, 0, 0, 79, on);
+	elLine(p, 80, 0, 80, 159, on);
+	elLine(p, 10, 120, 150, 120, on);
+	elLine(p, 40, 150, 45, 90, on);
+}
+
+static void drawCircle(elpanel *p) {
+
+	elCircle(p, 80, 40, 30, on);
+	elCircle(p, 40, 110, 20, on);
+	elCircle(p, 120, 110, 5, on);
+}
+
+static void drawRectangle(elpanel *p) {
+
+	elRectangle(p, 5, 5, 60, 40, on);
+	elRectangle(p, 80, 10, 150, 70, fill);
+	elRectangle(p, 100, 30, 130, 50, clear);
+}
+
+static void drawDegreeLine(elpanel *p) {
+
+	for (int degree = 0; degree < 360; degree += 30) {
+		elDegreeLine(p, 80, 80, degree, 10, 60, on);
+	}
+}
+
+static void drawText(elpanel *p) {
+
+	elCursorXY(p, 0, 0);
+	elWriteStr0(p, (unsigned char *)"EL160.80.38-SM1");
+	elCursorXY(p, 5, 3);
+	elWriteStr0(p, (unsigned char *)"planarTouch");
+	elCursorXY(p, 26, 9);
+	elChar(p, '#');
+}
+
+static void drawClear(elpanel *p) {
+
+	elClearText(p);
+	elClearGraph(p);
+}
+
+typedef struct BenchCase {
+	const char *name;
+	void (*draw)(elpanel *p);
+	uint8_t fill;		// VRAM contents before the case
+	uint8_t text;		// also compare the text layer
+}
+benchcase;
+
+static const benchcase cases[] = {
+	{ "pixel",		drawPixel,		0x00, 0 },
+	{ "line",		drawLine,		0x00, 0 },
+	{ "circle",		drawCircle,		0x00, 0 },
+	{ "rectangle",	drawRectangle,	0x00, 0 },
+	{ "degreeline",	drawDegreeLine,	0x00, 0 },
+	{ "text",		drawText,		0x00, 1 },
+	{ "clear",		drawClear,		0xA5, 1 },
+};
+
+// Text layer as printable rows, one per line
+static void dumpText(fakesed *s, elpanel *p, FILE *out) {
+
+	for (int row = 0; row < p->charRows; row++) {
+		for (int col = 0; col < p->addrIncr; col++) {
+			uint8_t c = s->vram[(uint16_t)(p->textBase + (row * p->addrIncr) + col)];
+			fputc(((c >= 0x20) && (c < 0x7F)) ? c : '.', out);
+		}
+		fputc('\n', out);
+	}
+}
+
+// Compare (or with update set, replace) a golden file
+static int checkGolden(const char *dir, const char *name, const char *ext,
+					   const char *data, size_t len, int update) {
+
+	char path[512];
+	snprintf(path, sizeof(path), "%s/%s.%s", dir, name, ext);
+
+	if (update) {
+		FILE *f = fopen(path, "wb");
+		if (!f || (fwrite(data, 1, len, f) != len)) {
+			fprintf(stderr, "%s: cannot write\n", path);
+			return 1;
+		}
+		fclose(f);
+		return 0;
+	}
+
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		fprintf(stderr, "%s: missing\n", path);
+		return 1;
+	}
+
+	char *golden = malloc(len + 1);
+	size_t got = fread(golden, 1, len + 1, f);
+	fclose(f);
+
+	int differ = (got != len) || memcmp(golden, data, len);
+	free(golden);
+
+	if (differ) {
+		fprintf(stderr, "%s: output differs\n", path);
+	}
+	return differ;
+}
+
+// Report a failed check, returns 1 if it failed
+static int expect(int ok, const char *check) {
+
+	if (!ok) {
+		fprintf(stderr, "%s: failed\n", check);
+	}
+	return !ok;
+}
+
+// All of len bytes at addr hold value
+static int vramIs(fakesed *s, uint16_t addr, uint16_t len, uint8_t value) {
+
+	for (uint16_t i = 0; i < len; i++) {
+		if (s->vram[(uint16_t)(addr + i)] != value) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// SCROLL last programmed with these start addresses
+static int scrollIs(fakesed *s, elpanel *p, uint16_t text, uint16_t graph,
+					uint16_t textLow, uint16_t graphLow) {
+
+	uint8_t lines = (p->charRows * EL_CHARHEIGHT * 2) - 1;
+	uint8_t want[10] = {
+		text & 0xff, text >> 8, lines,
+		graph & 0xff, graph >> 8, lines,
+		textLow & 0xff, textLow >> 8,
+		graphLow & 0xff, graphLow >> 8
+	};
+
+	return !memcmp(s->scroll, want, sizeof(want));
+}
+
+// Page cache: SCROLL keeps the live lower screen offsets on
+// every page, and drawing follows elPageSelect
+static int checkPages(fakesed *s, elpanel *p) {
+
+	int failed = 0;
+	uint16_t base;
+	int8_t page;
+
+	fakeBusReset(0x00);
+
+	elPageShow(p, EL_PAGE_LIVE);
+	failed |= expect(scrollIs(s, p, EL_TEXT_BASE, EL_GRAPH_BASE, EL_TEXT_LOW, EL_GRAPH_LOW),
+					 "pages: live SCROLL");
+
+	page = elPageAlloc(p, 1);
+	failed |= expect(page == 0, "pages: first page");
+	failed |= expect(elPageAlloc(p, 2) == ((EL_PAGES > 1) ? 1 : EL_PAGE_LIVE), "pages: VRAM full");
+	failed |= expect(elPageAlloc(p, EL_SCREEN_NONE) == EL_PAGE_LIVE, "pages: screen 0 refused");
+
+	base = EL_CACHE_BASE + (page * EL_SCREEN_SPAN);
+	elPageShow(p, page);
+	failed |= expect(scrollIs(s, p, base + EL_TEXT_BASE, base + EL_GRAPH_BASE,
+							  base + EL_TEXT_LOW, base + EL_GRAPH_LOW),
+					 "pages: page SCROLL");
+
+	elPageSelect(p, page);
+	elPixel(p, 0, 0, on);
+	failed |= expect(s->vram[base + EL_GRAPH_BASE] == 0x80, "pages: drawing lands on page");
+	failed |= expect(s->vram[EL_GRAPH_BASE] == 0x00, "pages: live screen untouched");
+
+	elPageFree(p, 1);
+	elPageFree(p, 2);
+	failed |= expect(scrollIs(s, p, EL_TEXT_BASE, EL_GRAPH_BASE, EL_TEXT_LOW, EL_GRAPH_LOW),
+					 "pages: freeing shown page returns to live");
+	failed |= expect(p->graphBase == EL_GRAPH_BASE, "pages: freeing selected page returns to live");
+
+	return failed;
+}
+
+// Text carries on where it left off after drawing has
+// moved the controller's cursor
+static int checkCursor(fakesed *s, elpanel *p) {
+
+	int failed = 0;
+	uint16_t row = EL_TEXT_BASE + (2 * p->addrIncr);
+
+	fakeBusReset(' ');
+
+	elCursorXY(p, 4, 2);
+	elWriteStr0(p, (unsigned char *)"ab");
+	elPixel(p, 0, 0, on);
+	elChar(p, 'c');
+	failed |= expect(!memcmp(&s->vram[row + 4], "abc", 3), "cursor: text continues after drawing");
+	failed |= expect((p->cursorX == 7) && (p->cursorY == 2), "cursor: position tracked");
+
+	return failed;
+}
+
+static const char pattern[] PROGMEM = "two panels, one bus";
+
+// Two panels behind their own /CS on shared data and control
+// lines: single panel calls must only reach their panel,
+// the *All calls must reach both, and no strobe may be
+// answered by both controllers.
+static int checkPanels(const char *dir) {
+
+	elpanel *panels[] = { &left, &right };
+	int failed = 0;
+	uint16_t graphSize = left.addrIncr * left.charRows * EL_CHARHEIGHT;
+	uint16_t textSize = left.addrIncr * left.charRows;
+	char *buf;
+	size_t len;
+	FILE *out;
+
+	fakeDetachAll();
+	fakesed *a = fakeAttach(&left);
+	fakesed *b = fakeAttach(&right);
+
+	fakeBusReset(0xA5);
+	elInitAll(panels, 2);
+
+	for (int i = 0; i < 2; i++) {
+		fakesed *s = i ? b : a;
+		failed |= expect(vramIs(s, EL_GRAPH_BASE, graphSize, 0x00), "panels: elInitAll clears graphics");
+		failed |= expect(vramIs(s, EL_TEXT_BASE, textSize, ' '), "panels: elInitAll clears text");
+		failed |= expect(scrollIs(s, panels[i], EL_TEXT_BASE, EL_GRAPH_BASE, EL_TEXT_LOW, EL_GRAPH_LOW),
+						 "panels: elInitAll SCROLL");
+	}
+
+	drawCircle(&left);
+	out = open_memstream(&buf, &len);
+	elDumpPBM(&left, out);
+	fclose(out);
+	failed |= checkGolden(dir, "circle", "pbm", buf, len, 0);
+	free(buf);
+	failed |= expect(vramIs(b, EL_GRAPH_BASE, graphSize, 0x00), "panels: drawing stays on its panel");
+
+	elCursorXY(&right, 0, 0);
+	elWriteStr0(&right, (unsigned char *)"right");
+	failed |= expect(!memcmp(&b->vram[EL_TEXT_BASE], "right", 5), "panels: text reaches its panel");
+	failed |= expect(vramIs(a, EL_TEXT_BASE, textSize, ' '), "panels: text stays on its panel");
+
+	elClearGraphAll(panels, 2);
+	elPaintAll(panels, 2, EL_GRAPH_BASE, pattern, sizeof(pattern));
+	for (int i = 0; i < 2; i++) {
+		fakesed *s = i ? b : a;
+		failed |= expect(!memcmp(&s->vram[EL_GRAPH_BASE], pattern, sizeof(pattern)),
+						 "panels: elPaintAll reaches both");
+		failed |= expect(vramIs(s, EL_GRAPH_BASE + sizeof(pattern), graphSize - sizeof(pattern), 0x00),
+						 "panels: elClearGraphAll clears both");
+	}
+
+	elPageShow(&right, elPageAlloc(&right, 1));
+	failed |= expect(scrollIs(a, &left, EL_TEXT_BASE, EL_GRAPH_BASE, EL_TEXT_LOW, EL_GRAPH_LOW),
+					 "panels: SCROLL stays on its panel");
+
+	failed |= expect(fakeConflicts == 0, "panels: no strobe answered twice");
+
+	return failed;
+}
+
+int main(int argc, char **argv) {
+
+	int update = 0;
+	int failed = 0;
+	const char *dir;
+
+	if ((argc > 1) && !strcmp(argv[1], "-u")) {
+		update = 1;
+		argv++;
+		argc--;
+	}
+	if (argc != 2) {
+		fprintf(stderr, "usage: elBench [-u] <golden dir>\n");
+		return 2;
+	}
+	dir = argv[1];
+
+	fakesed *sed = fakeAttach(&display);
+
+	fakeBusReset(0x00);
+	elInit(&display);
+
+	printf("%-12s %8s %8s %8s %8s %10s\n", "case", "commands", "writes", "reads", "busy", "bus cycles");
+
+	for (size_t i = 0; i < (sizeof(cases) / sizeof(cases[0])); i++) {
+		const benchcase *c = &cases[i];
+		char *buf;
+		size_t len;
+		FILE *out;
+
+		fakeBusReset(c->fill);
+
+		elStatsReset();
+		c->draw(&display);
+		elstats s = elStats;
+		uint32_t cycles = elStatsCycles();
+
+		printf("%-12s %8lu %8lu %8lu %8lu %10lu\n", c->name,
+			   (unsigned long)s.commands, (unsigned long)s.writes,
+			   (unsigned long)s.reads, (unsigned long)s.busyPolls,
+			   (unsigned long)cycles);
+
+		out = open_memstream(&buf, &len);
+		elDumpPBM(&display, out);
+		fclose(out);
+		failed |= checkGolden(dir, c->name, "pbm", buf, len, update);
+		free(buf);
+
+		if (c->text) {
+			out = open_memstream(&buf, &len);
+			dumpText(sed, &display, out);
+			fclose(out);
+			failed |= checkGolden(dir, c->name, "txt", buf, len, update);
+			free(buf);
+		}
+	}
+
+	if (!update) {
+		failed |= checkPages(sed, &display);
+		failed |= checkCursor(sed, &display);
+		failed |= checkPanels(dir);
+		printf(failed ? "FAILED\n" : "all cases match golden output\n");
+	}
+	return failed;
+}
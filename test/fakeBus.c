@@ -0,0 +1,165 @@
+// *******************************************************
+//
+// Host model of SED1330 controllers behind the planarTouch
+// ports. See fakeBus.h.
+//
+// The driver holds every strobe with _delay_us, so the bus
+// is sampled there: the first delay after WR or RD goes low
+// on a selected controller latches a write or drives the
+// byte to be read.
+//
+// *******************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "planarTouch.h"
+#include "fakeBus.h"
+
+// Sed 1330 commands the model decodes
+#define SCROLL		0x44
+#define CSRW		0x46
+#define CSRR		0x47
+#define MWRITE		0x42
+#define MREAD		0x43
+
+volatile uint8_t PORTB, PINB, DDRB;
+volatile uint8_t PORTC, PINC, DDRC;
+volatile uint8_t PORTD, PIND, DDRD;
+volatile uint8_t EICRA, EIMSK;
+
+uint32_t fakeConflicts;
+
+static fakesed seds[FAKE_PANELS];
+static uint8_t attached;
+
+fakesed *fakeAttach(const elpanel *p) {
+
+	if (attached >= FAKE_PANELS) {
+		return NULL;
+	}
+
+	fakesed *s = &seds[attached++];
+
+	memset(s, 0, sizeof(*s));
+	s->data = p->data;
+	s->dataPin = p->dataPin;
+	s->ctrl = p->ctrl;
+	s->cs = p->cs;
+	s->csMask = p->csMask;
+	return s;
+}
+
+void fakeDetachAll(void) {
+
+	attached = 0;
+}
+
+void fakeBusReset(uint8_t fill) {
+
+	for (uint8_t i = 0; i < attached; i++) {
+		fakesed *s = &seds[i];
+
+		memset(s->vram, fill, sizeof(s->vram));
+		memset(s->scroll, 0, sizeof(s->scroll));
+		s->cursor = 0;
+		s->command = 0;
+		s->param = 0;
+		s->wrLow = 0;
+		s->rdLow = 0;
+	}
+	fakeConflicts = 0;
+}
+
+static void busWrite(fakesed *s, uint8_t a0, uint8_t value) {
+
+	if (a0) {
+		s->command = value;
+		s->param = 0;
+		return;
+	}
+
+	switch (s->command) {
+		case CSRW:
+			if (s->param == 0) {
+				s->cursor = (s->cursor & 0xff00) | value;
+			} else if (s->param == 1) {
+				s->cursor = (s->cursor & 0x00ff) | (value << 8);
+			}
+			break;
+		case MWRITE:
+			s->vram[s->cursor++] = value;
+			break;
+		case SCROLL:
+			if (s->param < sizeof(s->scroll)) {
+				s->scroll[s->param] = value;
+			}
+			break;
+	}
+	s->param++;
+}
+
+static uint8_t busRead(fakesed *s, uint8_t ctrl) {
+
+	if (ctrl & _BV(EL_A1)) {
+		return (ctrl & _BV(EL_A0)) ? 0x07 : 0x3F;	// touch: no row, no column
+	}
+
+	if (!(ctrl & _BV(EL_A0))) {
+		return 0x40;								// status: clear to write
+	}
+
+	switch (s->command) {
+		case MREAD:
+			return s->vram[s->cursor++];
+		case CSRR:
+			return (s->param++ & 1) ? (s->cursor >> 8) : (s->cursor & 0xff);
+	}
+	return 0xFF;
+}
+
+void _delay_us(double us) {
+
+	uint8_t answered = 0;
+
+	(void)us;
+
+	for (uint8_t i = 0; i < attached; i++) {
+		fakesed *s = &seds[i];
+		uint8_t ctrl = *s->ctrl;
+		uint8_t selected = !s->cs || !(*s->cs & s->csMask);
+
+		if (selected && !(ctrl & _BV(EL_WR))) {
+			if (!s->wrLow) {
+				busWrite(s, ctrl & _BV(EL_A0), *s->data);
+				answered++;
+			}
+			s->wrLow = 1;
+		} else {
+			s->wrLow = 0;
+		}
+
+		if (selected && !(ctrl & _BV(EL_RD))) {
+			// touch reads change A0 while RD stays low
+			if (!s->rdLow || (ctrl & _BV(EL_A1))) {
+				*s->dataPin = busRead(s, ctrl);
+				if (!s->rdLow) {
+					answered++;
+				}
+			}
+			s->rdLow = 1;
+		} else {
+			s->rdLow = 0;
+		}
+	}
+
+	if (answered > 1) {
+		fakeConflicts++;
+	}
+}
+
+void _delay_ms(double ms) {
+
+	(void)ms;
+}
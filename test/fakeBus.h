@@ -0,0 +1,47 @@
+#ifndef FAKEBUS_H
+#define FAKEBUS_H
+// *******************************************************
+//
+// Host model of SED1330 controllers on the bus planarTouch.h
+// describes: VRAM, the cursor and enough command decoding
+// (CSRW, CSRR, MWRITE, MREAD, SCROLL) for the driver to
+// draw into them. Status reads always report ready and the
+// touch screen never reports a touch.
+//
+// Each controller is attached behind the ports and /CS of
+// an elpanel and only answers strobes while it is
+// selected, so several of them can share data and control
+// lines the way EL_PANEL_CS wires them.
+//
+// *******************************************************
+
+#include <stdint.h>
+#include "planarTouch.h"
+
+#define FAKE_VRAM_SIZE	0x10000
+#define FAKE_PANELS		4
+
+typedef struct FakeSed {
+	volatile uint8_t *data;		// Ports the controller sits behind
+	volatile uint8_t *dataPin;
+	volatile uint8_t *ctrl;
+	volatile uint8_t *cs;		// NULL if /CS is tied low
+	uint8_t csMask;
+
+	uint8_t vram[FAKE_VRAM_SIZE];
+	uint8_t scroll[10];			// Last SCROLL parameters
+
+	uint16_t cursor;
+	uint8_t command;
+	uint8_t param;				// Parameters (or reads) since command
+	uint8_t wrLow, rdLow;		// Strobe already handled
+}
+fakesed;
+
+extern uint32_t fakeConflicts;		// Strobes answered by more than one controller
+
+fakesed *fakeAttach(const elpanel *p);	/* Put a controller behind p's ports, NULL if all are in use */
+void fakeDetachAll(void);				/* Take every controller off the bus */
+void fakeBusReset(uint8_t fill);		/* Fill VRAM, forget controller state and conflicts */
+
+#endif
@@ -0,0 +1,13 @@
+// Host stdio plus the avr-libc stream extensions the driver uses
+#ifndef EL_HOST_STDIO_H
+#define EL_HOST_STDIO_H
+
+#include_next <stdio.h>
+
+#define _FDEV_SETUP_WRITE	2
+
+#define fdev_setup_stream(stream, put, get, rwflag)	((void)(put))
+#define fdev_set_udata(stream, u)	((void)(u))
+#define fdev_get_udata(stream)		((void *)0)
+
+#endif
@@ -0,0 +1,9 @@
+// Host stand-in for <util/delay.h>. The delays are where the
+// driver holds a strobe, so fakeBus.c samples the bus in them.
+#ifndef _UTIL_DELAY_H_
+#define _UTIL_DELAY_H_
+
+void _delay_us(double us);
+void _delay_ms(double ms);
+
+#endif